@@ -30,9 +30,13 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
         deltanote.cpp \
-    note.cpp
+    note.cpp \
+    noteio.cpp \
+    notepane.cpp
 
 HEADERS  += deltanote.h \
-    note.h
+    note.h \
+    noteio.h \
+    notepane.h
 
 FORMS    += deltanote.ui
@@ -26,6 +26,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QDir>
 #include <QDateTime>
 #include <QShortcut>
+#include <QMultiMap>
+#include <QStatusBar>
+#include <QTabBar>
 
 #include "deltanote.h"
 #include "ui_deltanote.h"
@@ -34,10 +37,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 /*!
  * \brief Constructor of Deltanote application.
  *
- * Initializes UI elements and attempts to open the last-used-note used by
- * Deltanote. If the open operation succeeds, then the opened note becomes the
- * active note. If the open operation fails then a default note "New Note" is
- * opened or created if it does not exist and becomes the active note.
+ * Initializes UI elements and attempts to reopen the notes that were open when
+ * Deltanote was last used. If the open operation succeeds, then the
+ * last-used-note becomes the active note. If the open operation fails then a
+ * default note "New Note" is opened or created if it does not exist and
+ * becomes the active note.
  *
  * \param parent
  */
@@ -50,7 +54,8 @@ Deltanote::Deltanote(QWidget *parent) :
 
     // Add custom-defined keyboard shortcuts
     new QShortcut(QKeySequence(tr("Ctrl+Q", "Quit")), this, SLOT(close()));
-    new QShortcut(QKeySequence(tr("Ctrl+W", "Quit")), this, SLOT(close()));
+    new QShortcut(QKeySequence(tr("Ctrl+W", "Close Tab")), this,
+                  SLOT(closeActiveTab()));
 
     // Setup UI
     ui->setupUi(this);
@@ -69,7 +74,30 @@ Deltanote::Deltanote(QWidget *parent) :
     // manually updated
     ui->treeView->hideColumn(TVFSMC_DATE_MODIFIED);
 
-    // Attempt to load last recently used note, else create a new note
+    // Set up note I/O with the durability mode chosen for this deployment
+    noteIO = new NoteIO(NoteIO::durabilityFromEnvironment(),
+                        NoteIO::syncWindowFromEnvironment(), this);
+    saveErrorLabel = new QLabel(this);
+    saveErrorLabel->hide();
+    statusBar()->addPermanentWidget(saveErrorLabel);
+    connect(noteIO, SIGNAL(commitFailed(QString)),
+            this, SLOT(noteCommitFailed(QString)));
+
+    // Set up memory accounting and trimming, which run once the user stops
+    // editing
+    memoryBudget = getMemoryBudget();
+    // Discarding the undo history of the note being edited must be opted into
+    trimActiveUndo = (qgetenv("DELTANOTE_TRIM_ACTIVE_UNDO") == "1");
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(2000);
+    connect(idleTimer, SIGNAL(timeout()), this, SLOT(trimMemory()));
+
+    // Record open notes again whenever their tabs are reordered
+    connect(ui->tabWidget->tabBar(), SIGNAL(tabMoved(int,int)),
+            this, SLOT(noteTabMoved(int,int)));
+
+    // Attempt to load last recently used notes, else create a new note
     QString openSettingsPath = getLastNoteSettingsPath();
     if (!openFromFile(openSettingsPath)) {
         // Auto-load failed; attempt to create default note "New Note" in
@@ -79,12 +107,13 @@ Deltanote::Deltanote(QWidget *parent) :
             QApplication::quit();
         }
     }
+    idleTimer->start();
 }
 
 /*!
  * \brief Destructor of Deltanote application.
  *
- * Saves active note and deletes UI elements.
+ * Records open notes, commits pending writes and deletes UI elements.
  */
 Deltanote::~Deltanote()
 {
@@ -92,52 +121,22 @@ Deltanote::~Deltanote()
         qWarning("last-recently-used note not recorded");
         QApplication::quit();
     }
-    delete ui;
-}
-
-/*!
- * \brief Saves content to the active note.
- *
- * Saves content to the active note when the note content buffer is
- * changed.
- */
-void Deltanote::on_textEdit_textChanged()
-{
-    activeNote.write(ui->textEdit->toPlainText());
-}
-
-/*!
- * \brief Attempts to rename the active note.
- *
- * Attempts to rename the active note to the note name buffer contents after
- * editing of the buffer finishes. If the rename operation succeeds, the
- * renamed note becomes the active note. If a note with the same name as the
- * name buffer contents exists in the folder of the active note, the name of
- * the active note is unchanged and the contents of the name buffer reverts to
- * the original name of the active note.
- */
-void Deltanote::on_lineEdit_editingFinished()
-{
-    QString originalName = activeNote.name();
-    // Reload old note name into lineEdit if new note name is invalid
-    if (!(activeNote.rename(ui->lineEdit->displayText()))) {
-        ui->lineEdit->setText(originalName);
+    if (!noteIO->flush()) {
+        qWarning("Pending note writes not committed");
     }
+    delete ui;
 }
 
 /*!
- * \brief Attempts to create a new note and open it.
+ * \brief Attempts to create a new note and open it in a new tab.
  *
- * Attempts to create a new note and open it. If all operations are successful,
- * the opened note becomes the active note. If note creation fails, no new
- * note is created, and if note opening fails, the previous active note remains
- * the active note with its contents loaded in the UI.
+ * Attempts to create a new note and open it in a new tab. If all operations
+ * are successful, the opened note becomes the active note. If note creation
+ * fails, no new note is created, and if note opening fails, the previous
+ * active note remains the active note.
  */
 void Deltanote::on_addNoteButton_clicked()
 {
-    // Save active note and load note "New Note" or create it if it does not
-    // exist
-    activeNote.write(ui->textEdit->toPlainText());
     // Attempt to create "New Note". If "New Note" exists create "New Note 2"
     // up until "New Note 1024". If "New Note" and "New Note 2" to
     // "New Note 1024" exist, do nothing
@@ -146,19 +145,15 @@ void Deltanote::on_addNoteButton_clicked()
             if (!QDir(getBaseNotePath()).exists("New Note "
                                                 + QString::number(i))) {
                 if (!switchNote(QDir(getBaseNotePath() + "/New Note "
-                                     + QString::number(i)))) {
+                                     + QString::number(i)), true)) {
                     qWarning("New note creation failed");
                     return;
                 }
-                // Select new file in sidebar
-                // TODO: Check if setCurrentIndex is successful
-                ui->treeView->setCurrentIndex(
-                            fsModel->index(activeNote.path()));
                 break;
             }
         }
     } else {
-        if (!switchNote(QDir(getBaseNotePath() + "/New Note"))) {
+        if (!switchNote(QDir(getBaseNotePath() + "/New Note"), true)) {
             qWarning("New note creation failed");
             return;
         }
@@ -170,7 +165,7 @@ void Deltanote::on_addNoteButton_clicked()
  */
 void Deltanote::on_deleteButton_clicked()
 {
-    if (!removeNote(activeNote.path())) {
+    if (!activePane() || !removeNote(activePane()->path())) {
         qWarning("Note removal failed");
     }
 }
@@ -178,23 +173,22 @@ void Deltanote::on_deleteButton_clicked()
 /*!
  * \brief Attempts to open the selected note or folder.
  *
- * Saves the current active note and attempts to open the selected note or
- * folder. If the selected item is a note, if the open operation is successful,
- * the selected note becomes the active note. If the note is already the active
- * note or note opening fails, then the previously active note is selected and
- * its contents remain in the UI. If the selected item is a folder, no action
- * is taken.
+ * Attempts to open the selected note or folder. If the selected item is a note
+ * which is already open, its tab becomes the current tab. Otherwise the note
+ * replaces the note in the current tab, or is opened in a new tab if Ctrl is
+ * held, and if the open operation is successful the selected note becomes the
+ * active note. If note opening fails, then the previously active note remains
+ * in the UI. If the selected item is a folder, no action is taken.
  *
  * \param &index The selected file in a QTreeView.
  */
 void Deltanote::on_treeView_clicked(const QModelIndex &index)
 {
-    // Check which note is selected in the sidebar and load it if it is not
-    // already the active note
-    activeNote.write(ui->textEdit->toPlainText());
     // TODO: check if file or directory
     if (fsModel->fileInfo(index).isFile()) {
-        if (switchNote(QDir(fsModel->fileInfo(index).absoluteFilePath()))) {
+        bool newTab = QApplication::keyboardModifiers() & Qt::ControlModifier;
+        if (switchNote(QDir(fsModel->fileInfo(index).absoluteFilePath()),
+                       newTab)) {
             return;
         }
         qWarning("Deltanote::on_treeView_clicked(): Note opening failed");
@@ -207,13 +201,177 @@ void Deltanote::on_treeView_clicked(const QModelIndex &index)
 }
 
 /*!
- * \brief Attempts to open an existing note on the filesystem from a file.
+ * \brief Makes the note in the current tab the active note.
  *
- * Attempts to open an existing note on the filesystem from a file and if
- * successful makes it the active note and returns true. Returns false if the
- * open operation fails.
+ * Loads the note if this is the first time its tab is shown, selects it in the
+ * sidebar and records it as last-recently-used.
  *
- * \warning The file at filepath must only contain an absolute filepath.
+ * \param index The index of the current tab.
+ */
+void Deltanote::on_tabWidget_currentChanged(int index)
+{
+    NotePane *pane = notePane(index);
+    if (!pane) {
+        return;
+    }
+    if (!pane->isLoaded() && !pane->load()) {
+        qWarning("Deltanote::on_tabWidget_currentChanged(): "
+                 "Note loading failed");
+    }
+    // Select note in sidebar
+    // TODO: Check if setCurrentIndex is successful
+    ui->treeView->setCurrentIndex(fsModel->index(pane->path()));
+    if (!recordLastNote()) {
+        qWarning("last-recently-used note not recorded");
+    }
+    // The previous note is no longer visible and may now be trimmed
+    idleTimer->start();
+}
+
+/*!
+ * \brief Closes a tab when its close button is clicked.
+ *
+ * \param index The index of the tab.
+ */
+void Deltanote::on_tabWidget_tabCloseRequested(int index)
+{
+    closeTab(index);
+}
+
+/*!
+ * \brief Closes the current tab, or the window if it is the only tab.
+ */
+void Deltanote::closeActiveTab()
+{
+    if (ui->tabWidget->count() > 1) {
+        closeTab(ui->tabWidget->currentIndex());
+        return;
+    }
+    close();
+}
+
+/*!
+ * \brief Records open notes after their tabs are reordered.
+ *
+ * \param from The previous index of the moved tab.
+ * \param to The new index of the moved tab.
+ */
+void Deltanote::noteTabMoved(int from, int to)
+{
+    Q_UNUSED(from);
+    Q_UNUSED(to);
+    if (!recordLastNote()) {
+        qWarning("last-recently-used note not recorded");
+    }
+}
+
+/*!
+ * \brief Reports a write which could not be committed after repeated attempts.
+ *
+ * The write stays queued and is retried when its note is switched, renamed or
+ * closed, and when Deltanote exits.
+ *
+ * \param filepath The absolute path of the file which could not be written.
+ */
+void Deltanote::noteCommitFailed(QString filepath)
+{
+    saveErrorLabel->setText(tr("Could not save %1")
+                            .arg(QFileInfo(filepath).fileName()));
+    saveErrorLabel->setToolTip(filepath);
+    saveErrorLabel->show();
+}
+
+/*!
+ * \brief Updates the tab of a renamed note and records open notes.
+ *
+ * \param name The new name of the note.
+ */
+void Deltanote::notePaneRenamed(QString name)
+{
+    int index = ui->tabWidget->indexOf(qobject_cast<NotePane *>(sender()));
+    if (index >= 0) {
+        ui->tabWidget->setTabText(index, name);
+    }
+    if (!recordLastNote()) {
+        qWarning("last-recently-used note not recorded");
+    }
+}
+
+/*!
+ * \brief Trims memory held by open notes down to the memory budget.
+ *
+ * Called once Deltanote is idle. If the memory used by open notes exceeds the
+ * memory budget, pending writes are committed to release their buffers and
+ * the undo history of notes in hidden tabs is discarded, largest note first.
+ * If that is not enough, notes in hidden tabs are unloaded, which releases
+ * their text and layout until their tab is shown again. The undo history of
+ * the active note is only discarded if DELTANOTE_TRIM_ACTIVE_UNDO is set to
+ * "1". Trimming, and remaining over the budget, are shown in the status bar.
+ */
+void Deltanote::trimMemory()
+{
+    qint64 usage = reportMemoryUsage();
+    if (memoryBudget <= 0 || usage <= memoryBudget) {
+        return;
+    }
+    qint64 untrimmedUsage = usage;
+
+    usage -= noteIO->pendingBytes();
+    if (!noteIO->flush()) {
+        qWarning("Deltanote::trimMemory(): Pending note writes not "
+                 "committed");
+    }
+
+    // Order notes in hidden tabs by increasing memory usage
+    QMultiMap<qint64, NotePane *> hiddenPanes;
+    for (int i = 0; i < ui->tabWidget->count(); i++) {
+        if (i != ui->tabWidget->currentIndex() && notePane(i)->isLoaded()) {
+            hiddenPanes.insert(notePane(i)->memoryUsage().total(),
+                               notePane(i));
+        }
+    }
+    QList<NotePane *> trimOrder = hiddenPanes.values();
+    for (int i = trimOrder.size() - 1; i >= 0 && usage > memoryBudget; i--) {
+        qint64 paneUsage = trimOrder.at(i)->memoryUsage().total();
+        trimOrder.at(i)->clearUndoHistory();
+        usage -= paneUsage - trimOrder.at(i)->memoryUsage().total();
+    }
+    for (int i = trimOrder.size() - 1; i >= 0 && usage > memoryBudget; i--) {
+        qint64 paneUsage = trimOrder.at(i)->memoryUsage().total();
+        if (trimOrder.at(i)->unload()) {
+            usage -= paneUsage;
+        }
+    }
+    if (usage > memoryBudget && trimActiveUndo && activePane()) {
+        activePane()->clearUndoHistory();
+    }
+
+    usage = reportMemoryUsage();
+    QString message = statusBar()->currentMessage();
+    if (usage < untrimmedUsage) {
+        message += tr("; trimmed from %1 KiB").arg(untrimmedUsage / 1024);
+        qDebug("Deltanote::trimMemory(): Trimmed memory usage from %lld KiB "
+               "to %lld KiB; budget %lld KiB", untrimmedUsage / 1024,
+               usage / 1024, memoryBudget / 1024);
+    }
+    if (usage > memoryBudget) {
+        message += tr("; over budget");
+    }
+    statusBar()->showMessage(message);
+}
+
+/*!
+ * \brief Attempts to reopen existing notes on the filesystem from a file.
+ *
+ * Attempts to open each existing note listed in a file in its own tab, in the
+ * listed order, and if successful makes the recorded active note the active
+ * note and returns true.
+ * Only the active note is read; other notes are read when their tab is first
+ * shown. Returns false if no note could be opened.
+ *
+ * \warning The file at filepath must contain the index of the active note on
+ * its first line, followed by absolute filepaths, one per line. A file
+ * containing only a single absolute filepath is also accepted.
  *
  * \param filepath The location of the file to be opened.
  *
@@ -225,55 +383,82 @@ bool Deltanote::openFromFile(QString filepath)
         QFile file(filepath);
         if (file.open(QIODevice::ReadOnly)) {
             QTextStream ts(&file);
-            // Remember to remove trailing newline from textStream.readAll()
-            // QString::simplified() does this for you
-            QString loadpath = ts.readAll().simplified();
-            ts.flush();
-            if (QDir(getBaseNotePath()).exists(loadpath)) {
+            // Skip blank lines by hand, since the SkipEmptyParts flag moved
+            // between Qt versions
+            QStringList lines = ts.readAll().split("\n");
+            file.close();
+            QStringList loadpaths;
+            for (int i = 0; i < lines.size(); i++) {
+                if (!lines.at(i).trimmed().isEmpty()) {
+                    loadpaths.append(lines.at(i).trimmed());
+                }
+            }
+            // The first line holds the index of the active note, unless the
+            // file was recorded with only a single note path
+            bool hasActiveIndex = false;
+            int activeIndex = 0;
+            if (!loadpaths.isEmpty()) {
+                activeIndex = loadpaths.first().toInt(&hasActiveIndex);
+                if (hasActiveIndex) {
+                    loadpaths.removeFirst();
+                } else {
+                    activeIndex = 0;
+                }
+            }
+            NotePane *activeTab = 0;
+            // Add tabs in recorded order without loading any of them
+            ui->tabWidget->blockSignals(true);
+            for (int i = 0; i < loadpaths.size(); i++) {
+                QString loadpath = loadpaths.at(i);
                 // loadpath must be an absolute filepath
-                activeNote = Note(QDir(loadpath));
-                ui->lineEdit->setText(activeNote.name());
-                ui->textEdit->setText(activeNote.read());
-                // Select new file in sidebar
-                // TODO: Check if setCurrentIndex is successful
-                ui->treeView->setCurrentIndex(
-                            fsModel->index(activeNote.path()));
-                file.close();
+                if (QDir(getBaseNotePath()).exists(loadpath)
+                        && findNotePane(QDir(loadpath).absolutePath()) < 0) {
+                    NotePane *pane = addNotePane(QDir(loadpath));
+                    if (i == activeIndex || !activeTab) {
+                        activeTab = pane;
+                    }
+                }
+            }
+            ui->tabWidget->blockSignals(false);
+            if (activeTab) {
+                ui->tabWidget->setCurrentWidget(activeTab);
+                on_tabWidget_currentChanged(ui->tabWidget->currentIndex());
                 return true;
             }
-            file.close();
         }
     }
     return false;
 }
 
 /*!
- * \brief Attempts to record the active note as last-recently-used on disk.
+ * \brief Attempts to record the open notes as last-recently-used on disk.
  *
- * Attempts to record the active note as last-recently-used on disk and if
- * successful returns true. If the recording operation fails then any changes
- * made on disk are reverted back to its state before the save operation and
- * returns false.
+ * Queues a write through NoteIO of the index of the active note, followed by
+ * every open note in tab order, and returns true if the write is queued. The
+ * record is committed with the durability mode of NoteIO; a failed commit is
+ * retried rather than rolled back. Returns false if the record cannot be
+ * queued.
  *
  * \return true on success, false otherwise.
  */
-// Returns false if save operation fails
-// Write last recently active note's filepath into
+// Returns false if the write cannot be queued
+// Write last recently active notes' filepaths into
 // [HOME]/.config/deltanote/lastnote to be auto-loaded on next init
 bool Deltanote::recordLastNote()
 {
     QString saveSettingsPath = getLastNoteSettingsPath();
     if (!saveSettingsPath.isEmpty()) {
-        QFile file(saveSettingsPath);
-        if (file.open(QIODevice::WriteOnly)) {
-            QTextStream ts(&file);
-            ts << activeNote.path();
-            ts.flush();
-            file.close();
+        QStringList savepaths;
+        savepaths.append(QString::number(
+                             qMax(ui->tabWidget->currentIndex(), 0)));
+        for (int i = 0; i < ui->tabWidget->count(); i++) {
+            savepaths.append(notePane(i)->path());
+        }
+        if (noteIO->write(saveSettingsPath, savepaths.join("\n"))) {
             return true;
         }
         qWarning("Deltanote::recordLastNote(): "
-                 "Could not open file in lastNoteSettingsPath");
+                 "Could not write file in lastNoteSettingsPath");
     }
     qWarning("Deltanote::recordLastNote(): "
              "Could not find lastNoteSettingsPath: %s"
@@ -284,32 +469,91 @@ bool Deltanote::recordLastNote()
 /*!
  * \brief Switches the current active note to a new active note.
  *
- * Switches the current active note to a new active note and if successful
- * updates relevant UI elements and returns true.
- *
- * \warning Always returns true; to be fixed in the future. Undefined behavior
- * if note switching or UI updating fail.
+ * If the note is already open, its tab becomes the current tab. Otherwise the
+ * note replaces the note in the current tab, or is opened in a new tab if
+ * newTab is true or no tab is open. If successful, relevant UI elements are
+ * updated, the new active note is recorded as last-recently-used and true is
+ * returned.
  *
  * \param path The absolute path to the note which is to replace the current
  * active note.
+ * \param newTab Whether the note is opened in a new tab.
+ *
+ * \return true on success, false otherwise.
+ */
+bool Deltanote::switchNote(QDir path, bool newTab)
+{
+    int index = findNotePane(path.absolutePath());
+    if (index >= 0) {
+        ui->tabWidget->setCurrentIndex(index);
+        return true;
+    }
+    NotePane *pane = activePane();
+    if (newTab || !pane) {
+        pane = addNotePane(path);
+        ui->tabWidget->setCurrentWidget(pane);
+        if (!pane->isLoaded() && !pane->load()) {
+            return false;
+        }
+        return showNote(pane);
+    }
+    return replaceNote(pane, path);
+}
+
+/*!
+ * \brief Replaces the note shown in a tab.
+ *
+ * The note is loaded into the tab even if the tab already shows a note at the
+ * same path, so that a removed note is replaced by a fresh one. If successful,
+ * relevant UI elements are updated, the new note is recorded as
+ * last-recently-used and true is returned.
+ *
+ * \param pane The NotePane of the tab.
+ * \param path The absolute path to the note which is to be shown.
+ *
+ * \return true on success, false otherwise.
+ */
+bool Deltanote::replaceNote(NotePane *pane, QDir path)
+{
+    if (!pane->setNote(Note(path, noteIO))) {
+        return false;
+    }
+    return showNote(pane);
+}
+
+/*!
+ * \brief Updates UI elements for the note shown in a tab.
  *
- * \return true on success, true otherwise.
+ * Commits the note if it was newly created, updates the tab name, selects the
+ * note in the sidebar and records open notes as last-recently-used.
+ *
+ * \param pane The NotePane of the tab.
+ *
+ * \return true on success, false otherwise.
  */
-bool Deltanote::switchNote(QDir path)
+bool Deltanote::showNote(NotePane *pane)
 {
-    activeNote = Note(path);
-    ui->lineEdit->setText(activeNote.name());
-    ui->textEdit->setText(activeNote.read());
+    // Commit a newly created note immediately so that it exists on disk
+    if (!QFile(pane->path()).exists() && !noteIO->flush()) {
+        qWarning("Deltanote::showNote(): Note creation not committed");
+    }
+    ui->tabWidget->setTabText(ui->tabWidget->indexOf(pane), pane->name());
+    // Select new file in sidebar
+    // TODO: Check if setCurrentIndex is successful
+    ui->treeView->setCurrentIndex(fsModel->index(pane->path()));
+    if (!recordLastNote()) {
+        qWarning("last-recently-used note not recorded");
+    }
     return true;
-    // TODO: Add return false on error
 }
 
 /*!
  * \brief Removes the note at a given path.
  *
- * If the remove operation is successful and files exist in the parent
- * directory of path after the operation, the active note is switched to the
- * note in the directory with the most recent date modified attribute and is
+ * If the remove operation is successful and the note was open in one of
+ * several tabs, its tab is closed. Otherwise, if files exist in the parent
+ * directory of path after the operation, the note in the tab of the removed
+ * note, or the active note, is switched to the note in the directory with the most recent date modified attribute and is
  * opened. If no notes exist in the directory after the note is removed, the
  * note "New Note" is created, becomes the active note and is opened. If the
  * remove operation fails, no changes are made to the filesystem.
@@ -324,39 +568,45 @@ bool Deltanote::switchNote(QDir path)
 bool Deltanote::removeNote(QString path)
 {
     if (QFile(path).exists()) {
+        // Drop pending writes so that the note is not recreated
+        noteIO->discard(path);
         if (QFile(path).remove()) {
+            int index = findNotePane(path);
+            if (index >= 0 && ui->tabWidget->count() > 1) {
+                return closeTab(index);
+            }
             QDir dir = QDir(path);
             dir.cdUp();
             QFileInfoList fil = dir.entryInfoList(QDir::Files);
+            QString nextPath;
             // If fil holds one or zero notes, create and/or open "New Note"
             if (fil.size() == 0) {
-                if (!switchNote(QDir(getBaseNotePath() + "/New Note"))) {
-                    qWarning("Note creation/opening failed");
-                    return false;
-                }
-                // Select new file in sidebar
-                // TODO: Check if setCurrentIndex is successful
-                ui->treeView->setCurrentIndex(
-                            fsModel->index(activeNote.path()));
-                return true;
+                nextPath = getBaseNotePath() + "/New Note";
             } else if (fil.size() == 1) {
-                if (!switchNote(QDir(fil.at(0).absoluteFilePath()))) {
-                    qWarning("Note switching failed");
-                    return false;
+                nextPath = fil.at(0).absoluteFilePath();
+            } else {
+                // Check for the most-recently-modified file in path's parent
+                // directory
+                QFileInfo mostRecent = fil.at(0);
+                QFileInfo checkRecent;
+                for (int i = 1; i < fil.size(); i++) {
+                    checkRecent = fil.at(i);
+                    if (mostRecent.lastModified()
+                            < checkRecent.lastModified()) {
+                        mostRecent = checkRecent;
+                    }
                 }
-                return true;
+                nextPath = mostRecent.absoluteFilePath();
             }
-            // Check for the most-recently-modified file in path's parent
-            // directory
-            QFileInfo mostRecent = fil.at(0);
-            QFileInfo checkRecent;
-            for (int i = 1; i < fil.size(); i++) {
-                checkRecent = fil.at(i);
-                if (mostRecent.lastModified() < checkRecent.lastModified()) {
-                    mostRecent = checkRecent;
-                }
+            // The tab of the removed note still shows its contents, so it must
+            // be reloaded even if nextPath is the removed path
+            bool switched = false;
+            if (index >= 0) {
+                switched = replaceNote(notePane(index), QDir(nextPath));
+            } else {
+                switched = switchNote(QDir(nextPath));
             }
-            if (!switchNote(QDir(mostRecent.absoluteFilePath()))) {
+            if (!switched) {
                 qWarning("Note switching failed");
                 return false;
             }
@@ -366,6 +616,137 @@ bool Deltanote::removeNote(QString path)
     return false;
 }
 
+/*!
+ * \brief Closes the tab at a given index.
+ *
+ * The last remaining tab is never closed, and its close button is hidden.
+ *
+ * \param index The index of the tab.
+ *
+ * \return true on success, false otherwise.
+ */
+bool Deltanote::closeTab(int index)
+{
+    NotePane *pane = notePane(index);
+    if (!pane || ui->tabWidget->count() <= 1) {
+        return false;
+    }
+    ui->tabWidget->removeTab(index);
+    // Deleting the pane commits its pending write
+    delete pane;
+    // The last remaining tab cannot be closed, so hide its close button
+    ui->tabWidget->setTabsClosable(ui->tabWidget->count() > 1);
+    if (!recordLastNote()) {
+        qWarning("last-recently-used note not recorded");
+    }
+    return true;
+}
+
+/*!
+ * \brief Opens a note in a new tab without loading it.
+ *
+ * \param path The absolute path to the note.
+ *
+ * \return The new NotePane.
+ */
+NotePane *Deltanote::addNotePane(QDir path)
+{
+    NotePane *pane = new NotePane(Note(path, noteIO));
+    connect(pane, SIGNAL(renamed(QString)),
+            this, SLOT(notePaneRenamed(QString)));
+    connect(pane, SIGNAL(edited()), idleTimer, SLOT(start()));
+    ui->tabWidget->addTab(pane, pane->name());
+    ui->tabWidget->setTabsClosable(ui->tabWidget->count() > 1);
+    return pane;
+}
+
+/*!
+ * \brief Get the NotePane of the current tab.
+ *
+ * \return The NotePane of the current tab, or 0 if no tab is open.
+ */
+NotePane *Deltanote::activePane()
+{
+    return qobject_cast<NotePane *>(ui->tabWidget->currentWidget());
+}
+
+/*!
+ * \brief Get the NotePane of a tab.
+ *
+ * \param index The index of the tab.
+ *
+ * \return The NotePane of the tab, or 0 if index is out of range.
+ */
+NotePane *Deltanote::notePane(int index)
+{
+    return qobject_cast<NotePane *>(ui->tabWidget->widget(index));
+}
+
+/*!
+ * \brief Get the index of the tab in which a note is open.
+ *
+ * \param path The absolute path to the note.
+ *
+ * \return The index of the tab, or -1 if the note is not open.
+ */
+int Deltanote::findNotePane(QString path)
+{
+    for (int i = 0; i < ui->tabWidget->count(); i++) {
+        if (notePane(i)->path() == path) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*!
+ * \brief Shows the memory used by open notes.
+ *
+ * The total is shown in the status bar and the usage of each note in the
+ * tooltip of its tab.
+ *
+ * \return The estimated memory used by open notes and pending writes, in
+ * bytes.
+ */
+qint64 Deltanote::reportMemoryUsage()
+{
+    qint64 usage = noteIO->pendingBytes();
+    for (int i = 0; i < ui->tabWidget->count(); i++) {
+        NotePane::MemoryUsage paneUsage = notePane(i)->memoryUsage();
+        ui->tabWidget->setTabToolTip(
+                    i, tr("Text: %1 KiB, layout: %2 KiB, undo: %3 KiB")
+                    .arg(paneUsage.text / 1024)
+                    .arg(paneUsage.layout / 1024)
+                    .arg(paneUsage.undo / 1024));
+        usage += paneUsage.total();
+    }
+    QString message = tr("Memory: %1 KiB").arg(usage / 1024);
+    if (memoryBudget > 0) {
+        message += tr(" of %1 KiB").arg(memoryBudget / 1024);
+    }
+    statusBar()->showMessage(message);
+    return usage;
+}
+
+/*!
+ * \brief Get the global memory budget of open notes.
+ *
+ * The budget is read in MiB from DELTANOTE_MEMORY_BUDGET. A budget of 64 MiB
+ * is used if the variable is unset or invalid, and a budget of 0 disables
+ * memory trimming.
+ *
+ * \return The memory budget in bytes.
+ */
+qint64 Deltanote::getMemoryBudget()
+{
+    bool ok = false;
+    qint64 budget = QString(qgetenv("DELTANOTE_MEMORY_BUDGET")).toLongLong(&ok);
+    if (!ok || budget < 0) {
+        budget = 64;
+    }
+    return budget * 1024 * 1024;
+}
+
 /*!
  * \brief Get the path of Deltanote's base directory
  *
@@ -26,8 +26,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QMainWindow>
 #include <QFileSystemModel>
+#include <QTimer>
+#include <QLabel>
 
 #include "note.h"
+#include "noteio.h"
+#include "notepane.h"
 
 namespace Ui {
 class Deltanote;
@@ -42,23 +46,45 @@ public:
     ~Deltanote();
 
 private slots:
-    void on_textEdit_textChanged();
-    void on_lineEdit_editingFinished();
     void on_addNoteButton_clicked();
     void on_deleteButton_clicked();
     void on_treeView_clicked(const QModelIndex &index);
+    void on_tabWidget_currentChanged(int index);
+    void on_tabWidget_tabCloseRequested(int index);
+    void closeActiveTab();
+    void noteTabMoved(int from, int to);
+    void notePaneRenamed(QString name);
+    void noteCommitFailed(QString filepath);
+    void trimMemory();
 
 private:
     Ui::Deltanote *ui;
     QFileSystemModel *fsModel;
-    // Only one note (and therefore one filepath) can currently be active at a
-    // time
-    Note activeNote;
+    // I/O scheduler shared by all open notes and the last-used-note record so
+    // that writes to them are ordered, coalesced and committed together
+    NoteIO *noteIO;
+    // Shows writes which could not be committed after repeated attempts
+    QLabel *saveErrorLabel;
+    // Memory is measured and trimmed once Deltanote has been idle this long
+    QTimer *idleTimer;
+    // Global memory budget in bytes, or 0 if memory is not trimmed
+    qint64 memoryBudget;
+    // Whether the undo history of the active note may be trimmed
+    bool trimActiveUndo;
 
     bool openFromFile(QString filepath);
     bool recordLastNote();
-    bool switchNote(QDir path);
+    bool switchNote(QDir path, bool newTab = false);
+    bool replaceNote(NotePane *pane, QDir path);
+    bool showNote(NotePane *pane);
     bool removeNote(QString path);
+    bool closeTab(int index);
+    NotePane *addNotePane(QDir path);
+    NotePane *activePane();
+    NotePane *notePane(int index);
+    int findNotePane(QString path);
+    qint64 reportMemoryUsage();
+    qint64 getMemoryBudget();
     QString getBaseNotePath();
     QString getLastNoteSettingsPath();
 };
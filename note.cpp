@@ -32,16 +32,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 Note::Note()
 {
     noteFilepath = QDir(getBaseNotePath() + "/New Note");
+    noteIO = 0;
 }
 
 /*!
  * \brief Constructor setting path of new note to "path".
  *
  * \param path Absolute filepath of the location of the new note object.
+ * \param io The NoteIO used to read and write the note, or 0 to access the
+ * note directly.
  */
-Note::Note(QDir path)
+Note::Note(QDir path, NoteIO *io)
 {
     noteFilepath = path;
+    noteIO = io;
 }
 
 /*!
@@ -75,6 +79,9 @@ QString Note::path()
 QString Note::read()
 {
     if (!(noteFilepath.path()).isEmpty() && !(noteFilepath.path().isNull())) {
+        if (noteIO) {
+            return noteIO->read(noteFilepath.path());
+        }
         QFile file(noteFilepath.path());
         if (file.open(QIODevice::ReadOnly)) {
             QTextStream ts(&file);
@@ -90,7 +97,9 @@ QString Note::read()
 /*!
  * \brief Write content to the note.
  *
- * If the write operation fails, no changes are made to the note.
+ * If the note has a NoteIO, the write is performed with its durability mode.
+ * Otherwise the note is overwritten in place, and if the write operation fails
+ * no changes are made to the note.
  *
  * \param text A QString containing text to be written to the note.
  *
@@ -99,6 +108,9 @@ QString Note::read()
 bool Note::write(QString text)
 {
     if (!(noteFilepath.path()).isEmpty() && !(noteFilepath.path().isNull())) {
+        if (noteIO) {
+            return noteIO->write(noteFilepath.path(), text);
+        }
         QFile file(noteFilepath.path());
         if (file.open(QIODevice::WriteOnly)) {
             QTextStream ts(&file);
@@ -111,6 +123,25 @@ bool Note::write(QString text)
     return false;
 }
 
+/*!
+ * \brief Write the contents of a document to the note.
+ *
+ * If the note has a NoteIO, the contents are only taken from the document when
+ * the write is committed. Otherwise the note is written immediately.
+ *
+ * \param source The document whose contents are to be written to the note.
+ *
+ * \return true if write operation succeeds, false otherwise.
+ */
+bool Note::write(QTextDocument *source)
+{
+    if (noteIO && !(noteFilepath.path()).isEmpty()
+            && !(noteFilepath.path().isNull())) {
+        return noteIO->write(noteFilepath.path(), source);
+    }
+    return write(source->toPlainText());
+}
+
 /*!
  * \brief Rename the note.
  *
@@ -123,6 +154,10 @@ bool Note::write(QString text)
 bool Note::rename(QString name)
 {
     if (!(noteFilepath.path()).isEmpty() && !(noteFilepath.path().isNull())) {
+        // Commit pending writes so that they are not made to the old path
+        if (noteIO && !noteIO->flush(noteFilepath.path())) {
+            return false;
+        }
         QFile file(noteFilepath.path());
         QStringList temp = noteFilepath.path().split("/");
         temp.removeLast();
@@ -138,6 +173,20 @@ bool Note::rename(QString name)
     return false;
 }
 
+/*!
+ * \brief Commit any pending write to the note.
+ *
+ * \return true if the pending write was committed or there was none, false
+ * otherwise.
+ */
+bool Note::flush()
+{
+    if (noteIO) {
+        return noteIO->flush(noteFilepath.path());
+    }
+    return true;
+}
+
 /*!
  * \brief Get the path of Deltanote's base directory
  *
@@ -26,20 +26,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QFileSystemModel>
 #include <QTextStream>
+#include <QTextDocument>
+
+#include "noteio.h"
 
 class Note
 {
 public:
     Note();
-    Note(QDir path);
+    Note(QDir path, NoteIO *io = 0);
     QString name();
     QString path();
     QString read();
     bool write(QString text);
+    bool write(QTextDocument *source);
     bool rename(QString name);
+    bool flush();
 
 private:
     QDir noteFilepath;
+    // Performs reads and writes if set, else the note is accessed directly
+    NoteIO *noteIO;
 
     QString getBaseNotePath();
     QString getLastNoteSettingsPath();
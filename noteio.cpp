@@ -0,0 +1,720 @@
+/*!
+\file    noteio.cpp
+\author  Nathan Robert Yee
+
+\section LICENSE
+
+noteio.cpp: Implementation file for NoteIO class
+Copyright (C) 2014  Nathan Robert Yee
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTextStream>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+#include "noteio.h"
+
+// NoteIO is the I/O scheduler shared by every open note. It performs every
+// read and write of note and settings files so that the durability mode is
+// applied consistently. Writes are held in memory for one sync window, during
+// which repeated writes to the same file are coalesced. Files pending
+// at the end of the window are committed together in the order they were
+// first queued, up to commitBudget bytes per window; any remainder is left for
+// the next window. In DurabilityDurable mode each parent directory is synced
+// only once per commit.
+//
+// Loads are not queued: a note is read synchronously when its tab is first
+// shown, since its contents are needed at once. They are only ordered after
+// pending writes, by returning queued content in place of the file, and are
+// not subject to the commit budget. Restored notes in background tabs are
+// deferred until shown rather than scheduled.
+//
+// Commits, including their fsyncs, run on the GUI thread, so typing stalls for
+// the duration of each commit. The commit budget bounds that stall on a
+// healthy disk but not on a slow one; the longest stall is reported by
+// reportStatistics().
+
+// Number of failed commits after which a write is no longer retried by the
+// sync window; it stays queued for explicit flushes, including the one at exit
+static const int maxCommitAttempts = 5;
+
+// Approximate number of bytes committed per sync window, which bounds the time
+// the GUI thread spends blocked on a single commit
+static const qint64 commitBudget = 1024 * 1024;
+
+/*!
+ * \brief Constructor of NoteIO.
+ *
+ * \param mode The durability mode applied to every write.
+ * \param syncWindow The time in milliseconds that a write may wait before
+ * being committed, unless the commit budget of the window is exhausted.
+ * \param parent
+ */
+NoteIO::NoteIO(Durability mode, int syncWindow, QObject *parent) :
+    QObject(parent),
+    durabilityMode(mode)
+{
+    stats.requests = 0;
+    stats.commits = 0;
+    stats.syncs = 0;
+    stats.bytes = 0;
+    stats.loads = 0;
+    stats.bytesRead = 0;
+    stats.ioTime = 0;
+    stats.stallMax = 0;
+    stats.latencyTotal = 0;
+    stats.latencyMax = 0;
+
+    // The timer is not restarted by later writes so that the window, and
+    // therefore the amount of work that can be lost, stays bounded
+    syncTimer.setSingleShot(true);
+    syncTimer.setInterval(syncWindow);
+    connect(&syncTimer, SIGNAL(timeout()), this, SLOT(commitPending()));
+    clock.start();
+}
+
+/*!
+ * \brief Destructor of NoteIO.
+ *
+ * Commits pending writes and reports I/O statistics.
+ */
+NoteIO::~NoteIO()
+{
+    if (!flush()) {
+        qWarning("NoteIO::~NoteIO(): Pending writes could not be committed "
+                 "and are lost");
+    }
+    reportStatistics();
+}
+
+/*!
+ * \brief Returns the durability mode applied to writes.
+ *
+ * \return The durability mode.
+ */
+NoteIO::Durability NoteIO::durability()
+{
+    return durabilityMode;
+}
+
+/*!
+ * \brief Returns the contents of a file.
+ *
+ * Content which is queued but not yet committed is returned in place of the
+ * content on disk. Otherwise the file is read immediately; reads are not
+ * queued or limited by the commit budget.
+ *
+ * \param filepath The absolute path of the file to be read.
+ *
+ * \return A QString containing the contents of the file or an empty QString if
+ * the read operation fails.
+ */
+QString NoteIO::read(QString filepath)
+{
+    if (pendingWrites.contains(filepath)) {
+        PendingWrite pending = pendingWrites.value(filepath);
+        if (!pending.hasSource) {
+            return pending.text;
+        } else if (pending.source) {
+            return pending.source->toPlainText();
+        }
+    }
+    qint64 start = clock.nsecsElapsed();
+    QFile file(filepath);
+    if (file.open(QIODevice::ReadOnly)) {
+        QTextStream ts(&file);
+        QString readContent = ts.readAll();
+        stats.loads++;
+        stats.bytesRead += file.size();
+        file.close();
+        qint64 elapsed = clock.nsecsElapsed() - start;
+        stats.ioTime += elapsed;
+        if (elapsed > stats.stallMax) {
+            stats.stallMax = elapsed;
+        }
+        return readContent;
+    }
+    return "";
+}
+
+/*!
+ * \brief Queues content to be written to a file.
+ *
+ * The content is committed with the current durability mode at the end of the
+ * current sync window; a later write to the same file replaces the queued
+ * content.
+ *
+ * \param filepath The absolute path of the file to be written.
+ * \param text A QString containing text to be written to the file.
+ *
+ * \return true if the write is queued, false otherwise.
+ */
+bool NoteIO::write(QString filepath, QString text)
+{
+    PendingWrite &pending = enqueue(filepath);
+    pending.text = text;
+    pending.source = 0;
+    pending.hasSource = false;
+    return true;
+}
+
+/*!
+ * \brief Queues the contents of a document to be written to a file.
+ *
+ * The plain text of the document is only taken when the write is committed,
+ * so that repeated edits do not each copy the document.
+ *
+ * \warning The document must not be deleted or reused for another file
+ * before the write is committed; call flush(filepath) first.
+ *
+ * \param filepath The absolute path of the file to be written.
+ * \param source The document whose contents are to be written to the file.
+ *
+ * \return true if the write is queued, false otherwise.
+ */
+bool NoteIO::write(QString filepath, QTextDocument *source)
+{
+    if (!source) {
+        return false;
+    }
+    PendingWrite &pending = enqueue(filepath);
+    pending.text.clear();
+    pending.source = source;
+    pending.hasSource = true;
+    return true;
+}
+
+/*!
+ * \brief Commits all pending writes immediately.
+ *
+ * \return true if every pending write was committed, false otherwise.
+ */
+bool NoteIO::flush()
+{
+    syncTimer.stop();
+    return commit(pendingOrder);
+}
+
+/*!
+ * \brief Commits any pending write to a file immediately.
+ *
+ * \param filepath The absolute path of the file.
+ *
+ * \return true if the pending write was committed or there was none, false
+ * otherwise.
+ */
+bool NoteIO::flush(QString filepath)
+{
+    if (!pendingWrites.contains(filepath)) {
+        return true;
+    }
+    bool success = commit(QStringList(filepath));
+    if (pendingOrder.isEmpty()) {
+        syncTimer.stop();
+    }
+    return success;
+}
+
+/*!
+ * \brief Drops any pending write to a file.
+ *
+ * Must be called before a file is removed so that a pending write does not
+ * recreate it.
+ *
+ * \param filepath The absolute path of the file.
+ */
+void NoteIO::discard(QString filepath)
+{
+    if (pendingWrites.remove(filepath) > 0) {
+        pendingOrder.removeAll(filepath);
+    }
+    if (pendingOrder.isEmpty()) {
+        syncTimer.stop();
+    }
+}
+
+/*!
+ * \brief Returns the memory held by pending writes.
+ *
+ * Writes whose content is taken from a document are not counted, since the
+ * document holds the content.
+ *
+ * \return The number of bytes held by pending writes.
+ */
+qint64 NoteIO::pendingBytes()
+{
+    qint64 bytes = 0;
+    for (int i = 0; i < pendingOrder.size(); i++) {
+        bytes += pendingWrites.value(pendingOrder.at(i)).text.size()
+                * sizeof(QChar);
+    }
+    return bytes;
+}
+
+/*!
+ * \brief Reports write latency and throughput of the current durability mode.
+ *
+ * Latency is measured from the first coalesced write request until its
+ * content is committed under the current durability mode. Throughput is the
+ * number of bytes committed and loaded per second spent blocked on I/O. The
+ * longest stall is the longest single commit or load, during which the GUI
+ * thread could not respond to input.
+ */
+void NoteIO::reportStatistics()
+{
+    double meanLatency = 0.0;
+    double throughput = 0.0;
+    if (stats.commits > 0) {
+        meanLatency = stats.latencyTotal / 1e6 / stats.commits;
+    }
+    if (stats.ioTime > 0) {
+        throughput = (stats.bytes + stats.bytesRead) / 1024.0
+                / (stats.ioTime / 1e9);
+    }
+    qDebug("NoteIO: %s: %lld requests, %lld commits, %lld syncs, %lld bytes "
+           "written; %lld loads, %lld bytes read; latency mean %.3f ms, "
+           "max %.3f ms; I/O %.3f ms, %.1f KiB/s; longest stall %.3f ms",
+           durabilityName(durabilityMode).toStdString().c_str(),
+           stats.requests, stats.commits, stats.syncs, stats.bytes,
+           stats.loads, stats.bytesRead, meanLatency, stats.latencyMax / 1e6,
+           stats.ioTime / 1e6, throughput, stats.stallMax / 1e6);
+}
+
+/*!
+ * \brief Get the durability mode selected by the environment.
+ *
+ * The mode is read from DELTANOTE_DURABILITY, which may be "fast", "atomic"
+ * or "durable". DurabilityAtomic is used if the variable is unset or invalid.
+ *
+ * \return The selected durability mode.
+ */
+NoteIO::Durability NoteIO::durabilityFromEnvironment()
+{
+    QString name = QString(qgetenv("DELTANOTE_DURABILITY")).toLower();
+    if (name == durabilityName(DurabilityFast)) {
+        return DurabilityFast;
+    } else if (name == durabilityName(DurabilityDurable)) {
+        return DurabilityDurable;
+    } else if (!name.isEmpty() && name != durabilityName(DurabilityAtomic)) {
+        qWarning("NoteIO::durabilityFromEnvironment(): "
+                 "Unknown durability mode: %s", name.toStdString().c_str());
+    }
+    return DurabilityAtomic;
+}
+
+/*!
+ * \brief Get the sync window selected by the environment.
+ *
+ * The window is read in milliseconds from DELTANOTE_SYNC_WINDOW. A window of
+ * 250 ms is used if the variable is unset or invalid.
+ *
+ * \return The sync window in milliseconds.
+ */
+int NoteIO::syncWindowFromEnvironment()
+{
+    bool ok = false;
+    int syncWindow = QString(qgetenv("DELTANOTE_SYNC_WINDOW")).toInt(&ok);
+    if (!ok || syncWindow < 0) {
+        return 250;
+    }
+    return syncWindow;
+}
+
+/*!
+ * \brief Get the name of a durability mode.
+ *
+ * \param mode The durability mode.
+ *
+ * \return A QString containing the name of the durability mode.
+ */
+QString NoteIO::durabilityName(Durability mode)
+{
+    switch (mode) {
+    case DurabilityFast:
+        return "fast";
+    case DurabilityDurable:
+        return "durable";
+    default:
+        return "atomic";
+    }
+}
+
+/*!
+ * \brief Commits pending writes at the end of a sync window.
+ *
+ * Writes are committed in the order they were queued until commitBudget is
+ * exhausted, skipping failed writes which are backing off or no longer
+ * retried. If writes which are still retried remain, the next sync window is
+ * started.
+ */
+void NoteIO::commitPending()
+{
+    QStringList filepaths;
+    qint64 budget = commitBudget;
+    qint64 now = clock.nsecsElapsed();
+    for (int i = 0; i < pendingOrder.size() && budget > 0; i++) {
+        PendingWrite pending = pendingWrites.value(pendingOrder.at(i));
+        if (!isRetryable(pending) || pending.retryAt > now) {
+            continue;
+        }
+        if (!pending.hasSource) {
+            budget -= pending.text.size() * sizeof(QChar);
+        } else if (pending.source) {
+            budget -= pending.source->characterCount() * sizeof(QChar);
+        }
+        filepaths.append(pendingOrder.at(i));
+    }
+    if (!commit(filepaths)) {
+        qWarning("NoteIO::commitPending(): Pending writes could not be "
+                 "committed");
+    }
+    restartSyncTimer();
+}
+
+/*!
+ * \brief Returns whether a pending write is still retried by sync windows.
+ *
+ * \param pending The pending write.
+ *
+ * \return true if the write has failed fewer than maxCommitAttempts times,
+ * false otherwise.
+ */
+bool NoteIO::isRetryable(PendingWrite pending)
+{
+    return pending.failures < maxCommitAttempts;
+}
+
+/*!
+ * \brief Starts the next sync window if any pending write is still retried.
+ */
+void NoteIO::restartSyncTimer()
+{
+    for (int i = 0; i < pendingOrder.size(); i++) {
+        if (isRetryable(pendingWrites.value(pendingOrder.at(i)))) {
+            if (!syncTimer.isActive()) {
+                syncTimer.start();
+            }
+            return;
+        }
+    }
+    syncTimer.stop();
+}
+
+/*!
+ * \brief Get the pending write to a file, queueing one if there is none.
+ *
+ * Starts the sync window if it is not already running.
+ *
+ * \param filepath The absolute path of the file.
+ *
+ * \return A reference to the pending write.
+ */
+NoteIO::PendingWrite &NoteIO::enqueue(QString filepath)
+{
+    stats.requests++;
+    if (!pendingWrites.contains(filepath)) {
+        PendingWrite pending;
+        pending.hasSource = false;
+        pending.queuedAt = clock.nsecsElapsed();
+        pending.failures = 0;
+        pending.retryAt = 0;
+        pendingWrites.insert(filepath, pending);
+        pendingOrder.append(filepath);
+    }
+    if (!syncTimer.isActive()) {
+        syncTimer.start();
+    }
+    return pendingWrites[filepath];
+}
+
+/*!
+ * \brief Commits pending writes with the current durability mode.
+ *
+ * In DurabilityDurable mode each file is written to a temporary file, synced
+ * and renamed over the original, after which the parent directory of every
+ * renamed file is synced once. Committed writes are removed from the queue.
+ * Writes which fail are returned to the front of the queue with a copy of
+ * their content, keeping the time they were first queued. They are retried by
+ * later sync windows with exponential backoff until they have failed
+ * maxCommitAttempts times, at which point commitFailed() is emitted once and
+ * they are only retried by flush(). Only writes whose document was deleted
+ * before the first attempt are dropped.
+ *
+ * \param filepaths The absolute paths of the pending files to be committed.
+ *
+ * \return true if every write was committed, false otherwise.
+ */
+bool NoteIO::commit(QStringList filepaths)
+{
+    bool success = true;
+    bool sync = (durabilityMode == DurabilityDurable);
+    QStringList directories;
+    QStringList failed;
+    QList<qint64> committedQueueTimes;
+    qint64 start = clock.nsecsElapsed();
+    for (int i = 0; i < filepaths.size(); i++) {
+        QString filepath = filepaths.at(i);
+        PendingWrite pending = pendingWrites.take(filepath);
+        pendingOrder.removeAll(filepath);
+        if (pending.hasSource && !pending.source) {
+            qWarning("NoteIO::commit(): Document of %s was deleted before "
+                     "commit", filepath.toStdString().c_str());
+            success = false;
+            continue;
+        }
+        QString text = pending.hasSource ? pending.source->toPlainText()
+                                         : pending.text;
+        // Replace the target of a symbolic link rather than the link itself
+        QString target = filepath;
+        QFileInfo info(filepath);
+        if (info.isSymLink()) {
+            target = info.canonicalFilePath();
+        }
+        bool replaced = false;
+        qint64 bytes = -1;
+        if (durabilityMode == DurabilityFast || target.isEmpty()) {
+            // A dangling symbolic link is written through in place
+            bytes = writeInPlace(filepath, text);
+        } else {
+            QString tempPath;
+            bytes = writeTemporary(target, text, sync, tempPath);
+            if (bytes >= 0 && !replace(tempPath, target)) {
+                QFile::remove(tempPath);
+                bytes = -1;
+            }
+            replaced = true;
+        }
+        if (bytes < 0) {
+            // Keep the content even if the document is deleted before retry
+            pending.text = text;
+            pending.source = 0;
+            pending.hasSource = false;
+            // Back off exponentially, and stop retrying automatically after
+            // maxCommitAttempts failures
+            pending.failures++;
+            if (pending.failures < maxCommitAttempts) {
+                pending.retryAt = clock.nsecsElapsed()
+                        + qint64(syncTimer.interval()) * 1000000
+                        * (qint64(1) << pending.failures);
+                qWarning("NoteIO::commit(): Could not commit %s; retrying",
+                         filepath.toStdString().c_str());
+            } else if (pending.failures == maxCommitAttempts) {
+                qWarning("NoteIO::commit(): Could not commit %s; retrying "
+                         "only on flush", filepath.toStdString().c_str());
+                emit commitFailed(filepath);
+            }
+            pendingWrites.insert(filepath, pending);
+            failed.append(filepath);
+            success = false;
+            continue;
+        }
+        stats.bytes += bytes;
+        committedQueueTimes.append(pending.queuedAt);
+        if (sync && replaced) {
+            stats.syncs++;
+            QString directory = QFileInfo(target).absolutePath();
+            if (!directories.contains(directory)) {
+                directories.append(directory);
+            }
+        }
+    }
+    // Make the renames themselves durable
+    for (int i = 0; i < directories.size(); i++) {
+        if (!syncDirectory(directories.at(i))) {
+            qWarning("NoteIO::commit(): Could not sync directory %s",
+                     directories.at(i).toStdString().c_str());
+            success = false;
+        }
+        stats.syncs++;
+    }
+    qint64 end = clock.nsecsElapsed();
+    stats.ioTime += end - start;
+    if (end - start > stats.stallMax) {
+        stats.stallMax = end - start;
+    }
+    for (int i = 0; i < committedQueueTimes.size(); i++) {
+        recordCommit(end - committedQueueTimes.at(i));
+    }
+    if (!failed.isEmpty()) {
+        pendingOrder = failed + pendingOrder;
+        restartSyncTimer();
+    }
+    return success;
+}
+
+/*!
+ * \brief Truncates a file and writes content to it.
+ *
+ * \param filepath The absolute path of the file to be written.
+ * \param text A QString containing text to be written to the file.
+ *
+ * \return The number of bytes written, or -1 on failure.
+ */
+qint64 NoteIO::writeInPlace(QString filepath, QString text)
+{
+    QFile file(filepath);
+    if (file.open(QIODevice::WriteOnly)) {
+        QTextStream ts(&file);
+        ts << text;
+        ts.flush();
+        qint64 bytes = file.size();
+        file.close();
+        return bytes;
+    }
+    return -1;
+}
+
+/*!
+ * \brief Writes content to a hidden temporary file beside a file.
+ *
+ * The temporary file is in the same directory as filepath so that it can be
+ * renamed over filepath atomically, and is given the permissions of filepath
+ * if it exists.
+ *
+ * \param filepath The absolute path of the file to be replaced.
+ * \param text A QString containing text to be written to the file.
+ * \param sync Whether the temporary file is synced to disk before returning.
+ * \param &tempPath Set to the path of the temporary file.
+ *
+ * \return The number of bytes written, or -1 on failure.
+ */
+qint64 NoteIO::writeTemporary(QString filepath, QString text, bool sync,
+                              QString &tempPath)
+{
+    QFileInfo info(filepath);
+    tempPath = info.absolutePath() + "/." + info.fileName() + ".dntmp";
+    QFile file(tempPath);
+    if (file.open(QIODevice::WriteOnly)) {
+        // Restrict the file before any content is written, so that the
+        // permissions are never looser than those of filepath and are synced
+        // with the content
+        if (info.exists()
+                && !file.setPermissions(QFile::permissions(filepath))) {
+            file.close();
+            QFile::remove(tempPath);
+            return -1;
+        }
+        QTextStream ts(&file);
+        ts << text;
+        ts.flush();
+        qint64 bytes = file.size();
+        bool success = (ts.status() == QTextStream::Ok);
+        if (success && sync) {
+            success = syncFile(file);
+        }
+        file.close();
+        if (success) {
+            return bytes;
+        }
+        QFile::remove(tempPath);
+    }
+    return -1;
+}
+
+/*!
+ * \brief Atomically replaces a file with another file.
+ *
+ * QFile::rename() refuses to overwrite an existing file, so the platform
+ * rename is used instead.
+ *
+ * \param tempPath The absolute path of the replacement file.
+ * \param filepath The absolute path of the file to be replaced.
+ *
+ * \return true on success, false otherwise.
+ */
+bool NoteIO::replace(QString tempPath, QString filepath)
+{
+#ifdef Q_OS_WIN
+    return MoveFileExW(reinterpret_cast<const wchar_t *>(
+                           QDir::toNativeSeparators(tempPath).utf16()),
+                       reinterpret_cast<const wchar_t *>(
+                           QDir::toNativeSeparators(filepath).utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return ::rename(QFile::encodeName(tempPath).constData(),
+                    QFile::encodeName(filepath).constData()) == 0;
+#endif
+}
+
+/*!
+ * \brief Syncs the contents of an open file to disk.
+ *
+ * \param &file The open file.
+ *
+ * \return true on success, false otherwise.
+ */
+bool NoteIO::syncFile(QFile &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return FlushFileBuffers(
+                reinterpret_cast<HANDLE>(_get_osfhandle(file.handle())));
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+/*!
+ * \brief Syncs the entries of a directory to disk.
+ *
+ * \warning Does nothing on Windows, where MOVEFILE_WRITE_THROUGH already
+ * makes renames durable.
+ *
+ * \param dirpath The absolute path of the directory.
+ *
+ * \return true on success, false otherwise.
+ */
+bool NoteIO::syncDirectory(QString dirpath)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(dirpath);
+    return true;
+#else
+    int fd = ::open(QFile::encodeName(dirpath).constData(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool success = (::fsync(fd) == 0);
+    ::close(fd);
+    return success;
+#endif
+}
+
+/*!
+ * \brief Records a committed write in the I/O statistics.
+ *
+ * \param latency Time from the write request until it was committed, in
+ * nanoseconds.
+ */
+void NoteIO::recordCommit(qint64 latency)
+{
+    stats.commits++;
+    stats.latencyTotal += latency;
+    if (latency > stats.latencyMax) {
+        stats.latencyMax = latency;
+    }
+}
@@ -0,0 +1,127 @@
+/*!
+\file    noteio.h
+\author  Nathan Robert Yee
+
+\section LICENSE
+
+noteio.h: Header file for NoteIO class
+Copyright (C) 2014  Nathan Robert Yee
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NOTEIO_H
+#define NOTEIO_H
+
+#include <QObject>
+#include <QFile>
+#include <QMap>
+#include <QPointer>
+#include <QTextDocument>
+#include <QStringList>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class NoteIO : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Durability modes, ordered from fastest to safest
+    enum Durability {
+        // Overwrite the file in place and leave it in the page cache
+        DurabilityFast,
+        // Write a temporary file and rename it over the file
+        DurabilityAtomic,
+        // Atomic writes whose fsyncs are grouped into one commit per window
+        DurabilityDurable
+    };
+
+    explicit NoteIO(Durability mode, int syncWindow, QObject *parent = 0);
+    ~NoteIO();
+
+    Durability durability();
+    QString read(QString filepath);
+    bool write(QString filepath, QString text);
+    bool write(QString filepath, QTextDocument *source);
+    bool flush();
+    bool flush(QString filepath);
+    void discard(QString filepath);
+    qint64 pendingBytes();
+    void reportStatistics();
+
+    static Durability durabilityFromEnvironment();
+    static int syncWindowFromEnvironment();
+    static QString durabilityName(Durability mode);
+
+signals:
+    void commitFailed(QString filepath);
+
+private slots:
+    void commitPending();
+
+private:
+    struct PendingWrite {
+        QString text;
+        // If set, the content is taken from the document when committed
+        QPointer<QTextDocument> source;
+        bool hasSource;
+        // Time at which the oldest uncommitted content was queued
+        qint64 queuedAt;
+        // Number of failed commits, and the time before which the write is
+        // not retried by commitPending()
+        int failures;
+        qint64 retryAt;
+    };
+
+    struct Statistics {
+        qint64 requests;
+        qint64 commits;
+        qint64 syncs;
+        qint64 bytes;
+        qint64 loads;
+        qint64 bytesRead;
+        // Time spent blocked on I/O, in nanoseconds
+        qint64 ioTime;
+        // Longest single commit or load, during which the GUI thread is
+        // blocked, in nanoseconds
+        qint64 stallMax;
+        // Time from a write request until its content is committed, in
+        // nanoseconds
+        qint64 latencyTotal;
+        qint64 latencyMax;
+    };
+
+    Durability durabilityMode;
+    QTimer syncTimer;
+    QElapsedTimer clock;
+    // Paths are committed in the order they were first queued
+    QStringList pendingOrder;
+    QMap<QString, PendingWrite> pendingWrites;
+    Statistics stats;
+
+    PendingWrite &enqueue(QString filepath);
+    bool commit(QStringList filepaths);
+    bool isRetryable(PendingWrite pending);
+    void restartSyncTimer();
+    qint64 writeInPlace(QString filepath, QString text);
+    qint64 writeTemporary(QString filepath, QString text, bool sync,
+                          QString &tempPath);
+    bool replace(QString tempPath, QString filepath);
+    bool syncFile(QFile &file);
+    bool syncDirectory(QString dirpath);
+    void recordCommit(qint64 latency);
+};
+
+#endif // NOTEIO_H
@@ -0,0 +1,309 @@
+/*!
+\file    notepane.cpp
+\author  Nathan Robert Yee
+
+\section LICENSE
+
+notepane.cpp: Implementation file for NotePane class
+Copyright (C) 2014  Nathan Robert Yee
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QFile>
+#include <QSplitter>
+#include <QVBoxLayout>
+#include <QTextBlock>
+#include <QTextLayout>
+
+#include "notepane.h"
+
+// A note pane shows one open note: a name buffer above a content buffer. Each
+// pane owns its own document, while all panes share the NoteIO of their notes.
+
+// Qt does not expose the memory held by a document's layout or undo history,
+// so it is estimated from the following per-item costs, in bytes
+static const qint64 undoCommandBytes = 64;
+static const qint64 layoutBlockBytes = 256;
+static const qint64 layoutLineBytes = 64;
+// Glyph indexes, advances, offsets, attributes and log clusters per character
+static const qint64 layoutCharacterBytes = 24;
+
+/*!
+ * \brief Constructor of NotePane.
+ *
+ * The contents of the note are not read until load() is called.
+ *
+ * \param note The note shown in the pane.
+ * \param parent
+ */
+NotePane::NotePane(Note note, QWidget *parent) :
+    QWidget(parent),
+    activeNote(note),
+    loaded(false),
+    loading(false),
+    undoBytes(0),
+    lastUndoSteps(0)
+{
+    lineEdit = new QLineEdit(this);
+    lineEdit->setObjectName("lineEdit");
+    lineEdit->setMaximumHeight(28);
+    QFont nameFont = lineEdit->font();
+    nameFont.setPointSize(14);
+    nameFont.setBold(true);
+    lineEdit->setFont(nameFont);
+    lineEdit->setText(activeNote.name());
+
+    textEdit = new QTextEdit(this);
+    textEdit->setObjectName("textEdit");
+    textEdit->setAcceptRichText(false);
+
+    QSplitter *splitter = new QSplitter(Qt::Vertical, this);
+    splitter->setHandleWidth(8);
+    splitter->setChildrenCollapsible(false);
+    splitter->addWidget(lineEdit);
+    splitter->addWidget(textEdit);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(splitter);
+
+    QMetaObject::connectSlotsByName(this);
+    connect(textEdit->document(), SIGNAL(contentsChange(int,int,int)),
+            this, SLOT(recordUndo(int,int,int)));
+}
+
+/*!
+ * \brief Destructor of NotePane.
+ *
+ * Commits any pending write to the note, since it refers to the document of
+ * the pane.
+ */
+NotePane::~NotePane()
+{
+    if (!activeNote.flush()) {
+        qWarning("NotePane::~NotePane(): Note not saved");
+    }
+}
+
+/*!
+ * \brief Returns the name of the note shown in the pane.
+ *
+ * \return A QString containing the name of the note.
+ */
+QString NotePane::name()
+{
+    return activeNote.name();
+}
+
+/*!
+ * \brief Returns the path of the note shown in the pane.
+ *
+ * \return A QString representing the path to the note.
+ */
+QString NotePane::path()
+{
+    return activeNote.path();
+}
+
+/*!
+ * \brief Returns whether the contents of the note have been read.
+ *
+ * \return true if the contents are loaded, false otherwise.
+ */
+bool NotePane::isLoaded()
+{
+    return loaded;
+}
+
+/*!
+ * \brief Reads the contents of the note into the pane.
+ *
+ * If the note does not exist, a write is queued so that it is created.
+ *
+ * \return true on success, false otherwise.
+ */
+bool NotePane::load()
+{
+    loading = true;
+    // Setting the text also clears the undo history
+    textEdit->setPlainText(activeNote.read());
+    loading = false;
+    loaded = true;
+    undoBytes = 0;
+    lastUndoSteps = 0;
+    if (!QFile(activeNote.path()).exists()) {
+        return activeNote.write(textEdit->document());
+    }
+    return true;
+}
+
+/*!
+ * \brief Releases the contents of the note from the pane.
+ *
+ * Any pending write to the note is committed first; if that fails, the write
+ * stays queued with a copy of the content. The document text, layout and undo
+ * history are released, and the note is read again by load().
+ *
+ * \return true on success, false otherwise.
+ */
+bool NotePane::unload()
+{
+    if (!loaded) {
+        return true;
+    }
+    // A write which fails stays queued with a copy of the content, so the
+    // document can still be released
+    if (!activeNote.flush()) {
+        qWarning("NotePane::unload(): Note not saved; keeping it queued");
+    }
+    loading = true;
+    // Clearing the text also clears the undo history
+    textEdit->clear();
+    loading = false;
+    loaded = false;
+    undoBytes = 0;
+    lastUndoSteps = 0;
+    return true;
+}
+
+/*!
+ * \brief Replaces the note shown in the pane and loads it.
+ *
+ * Any pending write to the previous note is committed first, since it refers
+ * to the document of the pane; if that fails, the write stays queued with a
+ * copy of the content.
+ *
+ * \param note The note to be shown in the pane.
+ *
+ * \return true on success, false otherwise.
+ */
+bool NotePane::setNote(Note note)
+{
+    // A write which fails stays queued with a copy of the content, so the
+    // document can still be reused
+    if (!activeNote.flush()) {
+        qWarning("NotePane::setNote(): Previous note not saved; keeping it "
+                 "queued");
+    }
+    activeNote = note;
+    lineEdit->setText(activeNote.name());
+    return load();
+}
+
+/*!
+ * \brief Discards the undo and redo history of the note.
+ */
+void NotePane::clearUndoHistory()
+{
+    textEdit->document()->clearUndoRedoStacks();
+    undoBytes = 0;
+    lastUndoSteps = 0;
+}
+
+/*!
+ * \brief Returns the estimated memory held by the pane.
+ *
+ * Layout is only counted for blocks which have been laid out.
+ *
+ * \return The estimated memory used by the text, layout and undo history of
+ * the document.
+ */
+NotePane::MemoryUsage NotePane::memoryUsage()
+{
+    QTextDocument *document = textEdit->document();
+    MemoryUsage usage;
+    usage.text = document->characterCount() * sizeof(QChar);
+    usage.layout = 0;
+    for (QTextBlock block = document->begin(); block.isValid();
+         block = block.next()) {
+        QTextLayout *layout = block.layout();
+        if (layout && layout->lineCount() > 0) {
+            usage.layout += layoutBlockBytes
+                    + layout->lineCount() * layoutLineBytes
+                    + block.length() * layoutCharacterBytes;
+        }
+    }
+    usage.undo = undoBytes;
+    return usage;
+}
+
+/*!
+ * \brief Saves content to the note.
+ *
+ * Queues a save of the note when the note content buffer is changed.
+ */
+void NotePane::on_textEdit_textChanged()
+{
+    if (!loading) {
+        activeNote.write(textEdit->document());
+        emit edited();
+    }
+}
+
+/*!
+ * \brief Attempts to rename the note.
+ *
+ * Attempts to rename the note to the note name buffer contents after editing
+ * of the buffer finishes. If a note with the same name as the name buffer
+ * contents exists in the folder of the note, the name of the note is unchanged
+ * and the contents of the name buffer reverts to the original name of the
+ * note.
+ */
+void NotePane::on_lineEdit_editingFinished()
+{
+    QString originalName = activeNote.name();
+    if (lineEdit->displayText() == originalName) {
+        return;
+    }
+    // Reload old note name into lineEdit if new note name is invalid
+    if (!(activeNote.rename(lineEdit->displayText()))) {
+        lineEdit->setText(originalName);
+        return;
+    }
+    emit renamed(activeNote.name());
+}
+
+/*!
+ * \brief Adds an edit of the document to the estimated undo history size.
+ *
+ * Changes made by undo and redo move existing history between the undo and
+ * redo stacks and are not counted. They are recognised by a drop in available
+ * undo steps, or by redo steps remaining afterwards; redoing the last undone
+ * step is therefore counted as a new edit.
+ *
+ * \param position The position of the edit in the document.
+ * \param charsRemoved The number of characters removed by the edit.
+ * \param charsAdded The number of characters added by the edit.
+ */
+void NotePane::recordUndo(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(position);
+    QTextDocument *document = textEdit->document();
+    int undoSteps = document->availableUndoSteps();
+    int previousUndoSteps = lastUndoSteps;
+    lastUndoSteps = undoSteps;
+    if (loading || !document->isUndoRedoEnabled()) {
+        return;
+    }
+    if (undoSteps == 0 && document->availableRedoSteps() == 0) {
+        undoBytes = 0;
+        return;
+    }
+    if (undoSteps < previousUndoSteps || document->availableRedoSteps() > 0) {
+        return;
+    }
+    undoBytes += undoCommandBytes
+            + (charsRemoved + charsAdded) * sizeof(QChar);
+}
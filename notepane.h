@@ -0,0 +1,82 @@
+/*!
+\file    notepane.h
+\author  Nathan Robert Yee
+
+\section LICENSE
+
+notepane.h: Header file for NotePane class
+Copyright (C) 2014  Nathan Robert Yee
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NOTEPANE_H
+#define NOTEPANE_H
+
+#include <QWidget>
+#include <QLineEdit>
+#include <QTextEdit>
+
+#include "note.h"
+
+class NotePane : public QWidget
+{
+    Q_OBJECT
+
+public:
+    // Estimated memory held by the pane, in bytes
+    struct MemoryUsage {
+        qint64 text;
+        qint64 layout;
+        qint64 undo;
+
+        qint64 total() const { return text + layout + undo; }
+    };
+
+    explicit NotePane(Note note, QWidget *parent = 0);
+    ~NotePane();
+
+    QString name();
+    QString path();
+    bool isLoaded();
+    bool load();
+    bool unload();
+    bool setNote(Note note);
+    void clearUndoHistory();
+    MemoryUsage memoryUsage();
+
+signals:
+    void renamed(QString name);
+    void edited();
+
+private slots:
+    void on_textEdit_textChanged();
+    void on_lineEdit_editingFinished();
+    void recordUndo(int position, int charsRemoved, int charsAdded);
+
+private:
+    QLineEdit *lineEdit;
+    QTextEdit *textEdit;
+    Note activeNote;
+    // Contents are only read once the pane is first shown
+    bool loaded;
+    // Set while contents are being read so that they are not saved back
+    bool loading;
+    // Estimated size of the undo history of the document, in bytes
+    qint64 undoBytes;
+    // Undo steps available after the last change to the document
+    int lastUndoSteps;
+};
+
+#endif // NOTEPANE_H